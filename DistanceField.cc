@@ -21,8 +21,21 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "DistanceField.h"
+#include <algorithm>
 #include <math.h>
 #include <float.h>
+#include "Parallel.h"
+
+// Number of coarse cells along each side of a block baked as one task
+#define BAKE_BLOCK 8
+
+struct DistanceField::BakeJob
+{
+	DistanceField *	field;
+	int				x0, y0, x1, y1;		// node range to bake, inclusive
+	int				bx0, by0, nbx;		// first block and blocks per row
+	bool			coarse;				// bake the coarse nodes as well as the tiles
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -32,16 +45,29 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 DistanceField::DistanceField()
 :	pValues(NULL),
 	fWidth(0.f),
-	nResolution(0)
+	nResolution(0),
+	pTileValues(NULL),
+	pTileIndex(NULL),
+	nSubdivisions(1)
 {}
 ///////////////////////////////////////////////////////////////////////////////
 DistanceField::~DistanceField()
 {
 	delete [] pValues;
+	delete [] pTileValues;
+	delete [] pTileIndex;
 }
 ///////////////////////////////////////////////////////////////////////////////
 void DistanceField::Create(int nresolution, float meters)
 {
+	delete [] pValues;
+	delete [] pTileValues;
+	delete [] pTileIndex;
+	pTileValues = NULL;
+	pTileIndex = NULL;
+	nSubdivisions = 1;
+	scene.Clear();
+
 	nresolution++;
 	pValues = new float[nresolution * nresolution];
 
@@ -57,52 +83,185 @@ void DistanceField::Create(int nresolution, float meters)
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////
-void DistanceField::AddCircle(float x, float y, float r)
+// Bakes the coarse grid, then builds and bakes a tile of nsubdivisions x 
+// nsubdivisions fine cells for every coarse cell whose corners come within 
+// band of the surface.  Later bakes update the existing tiles but do not 
+// create new ones, so call this again once the surface has moved far.
+void DistanceField::Refine(int nsubdivisions, float band)
 {
-	for (int iy=0; iy<nResolution; iy++)
-	{
-		float fy = (iy / (float) nResolution) * fWidth;
+	delete [] pTileValues;
+	delete [] pTileIndex;
+	pTileValues = NULL;
+	pTileIndex = NULL;
+
+	BakeRegion(0.f, 0.f, fWidth, fWidth, true);
+
+	int ncells = nResolution - 1;
+	int ntiles = 0;
+	pTileIndex = new int[ncells * ncells];
+	nSubdivisions = nsubdivisions;
 
-		for (int ix=0; ix<nResolution; ix++)
+	for (int cy=0; cy<ncells; cy++)
+	{
+		for (int cx=0; cx<ncells; cx++)
 		{
-			float fx = (ix / (float) nResolution) * fWidth;
+			float d0 = pValues[(cy * nResolution) + cx];
+			float d1 = pValues[(cy * nResolution) + cx + 1];
+			float d2 = pValues[((cy + 1) * nResolution) + cx];
+			float d3 = pValues[((cy + 1) * nResolution) + cx + 1];
 
-			float dx = fx - x;
-			float dy = fy - y;
-			float d = sqrt(dx*dx + dy*dy) - r;
+			float lo = std::min(std::min(d0, d1), std::min(d2, d3));
+			float hi = std::max(std::max(d0, d1), std::max(d2, d3));
+			bool crossing = (lo <= 0.f) && (hi >= 0.f);
+			bool inband = std::min(fabsf(lo), fabsf(hi)) < band;
 
-			int i = (iy * nResolution) + ix;
-			float current = pValues[i];
-			pValues[i] = (current < d) ? current : d;
+			pTileIndex[(cy * ncells) + cx] = (crossing || inband) ? ntiles++ : -1;
 		}
 	}
+
+	int stride = nsubdivisions + 1;
+	pTileValues = new float[ntiles * stride * stride];
+
+	BakeRegion(0.f, 0.f, fWidth, fWidth, false);
 }
 ///////////////////////////////////////////////////////////////////////////////
-void DistanceField::SubCircle(float x, float y, float r)
+void DistanceField::Bake()
+{
+	Bake(0.f, 0.f, fWidth, fWidth);
+}
+///////////////////////////////////////////////////////////////////////////////
+void DistanceField::Bake(float minx, float miny, float maxx, float maxy)
+{
+	BakeRegion(minx, miny, maxx, maxy, true);
+}
+///////////////////////////////////////////////////////////////////////////////
+void DistanceField::BakeRegion(float minx, float miny, float maxx, float maxy, bool coarse)
+{
+	float h = fWidth / nResolution;
+	float last = (float)(nResolution - 1);
+
+	BakeJob job;
+	job.field = this;
+	job.coarse = coarse;
+	job.x0 = (int) floorf(std::max(minx / h, 0.f));
+	job.y0 = (int) floorf(std::max(miny / h, 0.f));
+	job.x1 = (int) ceilf(std::min(maxx / h, last));
+	job.y1 = (int) ceilf(std::min(maxy / h, last));
+
+	if (job.x0 > job.x1 || job.y0 > job.y1)
+		return;
+
+	job.bx0 = job.x0 / BAKE_BLOCK;
+	job.by0 = job.y0 / BAKE_BLOCK;
+	job.nbx = (job.x1 / BAKE_BLOCK) - job.bx0 + 1;
+	int nby = (job.y1 / BAKE_BLOCK) - job.by0 + 1;
+
+	scene.Prepare();
+	ParallelFor(job.nbx * nby, &BakeBlock, &job);
+}
+///////////////////////////////////////////////////////////////////////////////
+// Each block owns its nodes and the fine tiles of its cells, so blocks can be 
+// baked concurrently without sharing any writes.
+void DistanceField::BakeBlock(void * context, int index, int thread)
 {
-	for (int iy=0; iy<nResolution; iy++)
+	const BakeJob * job = (const BakeJob *) context;
+	DistanceField * field = job->field;
+
+	int bx = job->bx0 + (index % job->nbx);
+	int by = job->by0 + (index / job->nbx);
+	int x0 = std::max(bx * BAKE_BLOCK, job->x0);
+	int y0 = std::max(by * BAKE_BLOCK, job->y0);
+	int x1 = std::min((bx + 1) * BAKE_BLOCK - 1, job->x1);
+	int y1 = std::min((by + 1) * BAKE_BLOCK - 1, job->y1);
+
+	int res = field->nResolution;
+	float h = field->fWidth / res;
+
+	std::vector<int> prims;
+	field->scene.Gather(x0 * h, y0 * h, (x1 + 1) * h, (y1 + 1) * h, prims);
+	const int * list = prims.empty() ? NULL : &prims[0];
+	int count = (int) prims.size();
+
+	for (int iy=y0; iy<=y1 && job->coarse; iy++)
 	{
-		float fy = (iy / (float) nResolution) * fWidth;
+		for (int ix=x0; ix<=x1; ix++)
+		{
+			field->pValues[(iy * res) + ix] = field->scene.Distance(ix * h, iy * h, list, count);
+		}
+	}
+
+	if (!field->pTileIndex)
+		return;
 
-		for (int ix=0; ix<nResolution; ix++)
+	int ncells = res - 1;
+	int nsub = field->nSubdivisions;
+	int stride = nsub + 1;
+
+	for (int cy=y0; cy<=std::min(y1, ncells - 1); cy++)
+	{
+		for (int cx=x0; cx<=std::min(x1, ncells - 1); cx++)
 		{
-			float fx = (ix / (float) nResolution) * fWidth;
+			int t = field->pTileIndex[(cy * ncells) + cx];
+			if (t < 0)
+				continue;
 
-			float dx = fx - x;
-			float dy = fy - y;
-			float d = r - sqrt(dx*dx + dy*dy);
+			float * tile = field->pTileValues + (t * stride * stride);
+			for (int iy=0; iy<stride; iy++)
+			{
+				float fy = (cy + (iy / (float) nsub)) * h;
 
-			int i = (iy * nResolution) + ix;
-			float current = pValues[i];
-			pValues[i] = (current < d) ? current : d;
+				for (int ix=0; ix<stride; ix++)
+				{
+					float fx = (cx + (ix / (float) nsub)) * h;
+					tile[(iy * stride) + ix] = field->scene.Distance(fx, fy, list, count);
+				}
+			}
 		}
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////
+void DistanceField::AddCircle(float x, float y, float r)
+{
+	scene.AddCircle(x, y, r);
+
+	float reach = r + scene.GetMaxDistance();
+	Bake(x - reach, y - reach, x + reach, y + reach);
+}
+///////////////////////////////////////////////////////////////////////////////
+void DistanceField::SubCircle(float x, float y, float r)
+{
+	scene.AddCircle(x, y, r, SDF_UNION, true);
+	Bake();
+}
+///////////////////////////////////////////////////////////////////////////////
+// x and y are in coarse grid units.  Returns the fine tile covering that 
+// point, if any, along with the point in the tile's own grid units.
+const float * DistanceField::FindTile(float x, float y, float * outx, float * outy) const
+{
+	if (!pTileIndex)
+		return NULL;
+
+	int ncells = nResolution - 1;
+	int cx = (int) x;
+	int cy = (int) y;
+	if (x < 0.f || y < 0.f || cx >= ncells || cy >= ncells)
+		return NULL;
+
+	int t = pTileIndex[(cy * ncells) + cx];
+	if (t < 0)
+		return NULL;
+
+	*outx = (x - cx) * nSubdivisions;
+	*outy = (y - cy) * nSubdivisions;
+
+	int stride = nSubdivisions + 1;
+	return pTileValues + (t * stride * stride);
+}
+///////////////////////////////////////////////////////////////////////////////
 float DistanceField::SampleDistance(int x, int y) const
 {
-	x = (x < 0) ? 0 : ((x > nResolution) ? nResolution : x);
-	y = (y < 0) ? 0 : ((y > nResolution) ? nResolution : y);
+	x = (x < 0) ? 0 : ((x >= nResolution) ? nResolution - 1 : x);
+	y = (y < 0) ? 0 : ((y >= nResolution) ? nResolution - 1 : y);
 	return pValues[y * nResolution + x];
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -110,6 +269,25 @@ float DistanceField::SampleDistance(float x, float y) const
 {
 	x = (x / fWidth) * nResolution;
 	y = (y / fWidth) * nResolution;
+
+	float tx, ty;
+	const float * tile = FindTile(x, y, &tx, &ty);
+	if (tile)
+	{
+		int stride = nSubdivisions + 1;
+		int ix = std::min((int) tx, nSubdivisions - 1);
+		int iy = std::min((int) ty, nSubdivisions - 1);
+		float dx = tx - ix;
+		float dy = ty - iy;
+
+		const float * row0 = tile + (iy * stride) + ix;
+		const float * row1 = row0 + stride;
+
+		float d0 = row0[0] * (1.f - dx) + row0[1] * dx;
+		float d1 = row1[0] * (1.f - dx) + row1[1] * dx;
+		return d0 * (1.f - dy) + d1 * dy;
+	}
+
 	int ix = (int) x;
 	int iy = (int) y;
 	float dx = x - floor(x);
@@ -125,15 +303,38 @@ float DistanceField::SampleDistance(float x, float y) const
 	return d0 * (1.f - dy) + d1 * dy;
 }
 ///////////////////////////////////////////////////////////////////////////////
+// Unfiltered lookup of the nearest node, from the fine tile when there is one.
+float DistanceField::SampleNearest(float x, float y) const
+{
+	x = (x / fWidth) * nResolution;
+	y = (y / fWidth) * nResolution;
+
+	float tx, ty;
+	const float * tile = FindTile(x, y, &tx, &ty);
+	if (tile)
+	{
+		int stride = nSubdivisions + 1;
+		return tile[((int)(ty + 0.5f) * stride) + (int)(tx + 0.5f)];
+	}
+
+	return SampleDistance((int)(x + 0.5f), (int)(y + 0.5f));
+}
+///////////////////////////////////////////////////////////////////////////////
 void DistanceField::SampleGradient(float x, float y, float * outx, float * outy) const
 {
-	float d0 = SampleDistance(x, y - (0.5f / nResolution));
-	float d1 = SampleDistance(x - (0.5f / nResolution), y);
-	float d2 = SampleDistance(x + (0.5f / nResolution), y);
-	float d3 = SampleDistance(x, y + (0.5f / nResolution));
+	// Take the differences at the resolution of whichever level is sampled
+	float h = 0.5f / nResolution;
+	float tx, ty;
+	if (FindTile((x / fWidth) * nResolution, (y / fWidth) * nResolution, &tx, &ty))
+		h /= nSubdivisions;
+
+	float d0 = SampleDistance(x, y - h);
+	float d1 = SampleDistance(x - h, y);
+	float d2 = SampleDistance(x + h, y);
+	float d3 = SampleDistance(x, y + h);
 
-	*outx = (d2 - d1) * nResolution;
-	*outy = (d3 - d0) * nResolution;
+	*outx = (d2 - d1) / (2.f * h);
+	*outy = (d3 - d0) / (2.f * h);
 }
 ///////////////////////////////////////////////////////////////////////////////
 float DistanceField::SampleNormal(float x, float y, float * outx, float * outy) const
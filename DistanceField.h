@@ -23,6 +23,13 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef HH_SDFC_DISTANCEFIELD_HH
 #define HH_SDFC_DISTANCEFIELD_HH
 
+#include "SdfScene.h"
+
+// A coarse uniform grid of distances covering the whole field, plus optional 
+// fine tiles for the coarse cells that lie within a band of the surface.  
+// Sampling uses the fine tile for a cell when it has one.  Values are baked 
+// from the field's SdfScene in square blocks of cells, in parallel, and only 
+// for the region asked for.
 class DistanceField
 {	
 public:
@@ -30,12 +37,19 @@ public:
 	~DistanceField();
 
 	void 	Create(int nresolution, float meters);
+	void	Refine(int nsubdivisions, float band);
+	void	Bake();
+	void	Bake(float minx, float miny, float maxx, float maxy);
 
 	void	AddCircle(float x, float y, float r);
 	void	SubCircle(float x, float y, float r);
 
+	SdfScene &			GetScene() { return scene; }
+	const SdfScene &	GetScene() const { return scene; }
+
 	float 	SampleDistance(int x, int y) const;
 	float	SampleDistance(float x, float y) const;
+	float	SampleNearest(float x, float y) const;
 	void	SampleGradient(float x, float y, float * outx, float * outy) const;
 	float	SampleNormal(float x, float y, float * outx, float * outy) const;
 
@@ -43,9 +57,21 @@ private:
 	DistanceField(const DistanceField &);
 	DistanceField & operator = (const DistanceField &);
 
+	struct BakeJob;
+
+	void			BakeRegion(float minx, float miny, float maxx, float maxy, bool coarse);
+	static void		BakeBlock(void * context, int index, int thread);
+	const float *	FindTile(float x, float y, float * outx, float * outy) const;
+
+	SdfScene	scene;
+
 	float *		pValues;
 	float		fWidth;
 	int			nResolution;
+
+	float *		pTileValues;
+	int *		pTileIndex;
+	int			nSubdivisions;
 };
 
 #endif // HH_SDFC_DISTANCEFIELD_HH
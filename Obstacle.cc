@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Obstacle.h"
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// -------------------------------- Obstacle ----------------------------------
+//
+///////////////////////////////////////////////////////////////////////////////
+Obstacle::Obstacle()
+:	fHalf(0.f),
+	fX(0.f),
+	fY(0.f),
+	fAngle(0.f),
+	fCos(1.f),
+	fSin(0.f),
+	fVX(0.f),
+	fVY(0.f),
+	fW(0.f)
+{}
+///////////////////////////////////////////////////////////////////////////////
+Obstacle::~Obstacle()
+{}
+///////////////////////////////////////////////////////////////////////////////
+void Obstacle::Create(int nresolution, float meters)
+{
+	field.Create(nresolution, meters);
+	fHalf = meters * 0.5f;
+}
+///////////////////////////////////////////////////////////////////////////////
+void Obstacle::SetTransform(float x, float y, float angle)
+{
+	fX = x;
+	fY = y;
+	fAngle = angle;
+	fCos = cosf(angle);
+	fSin = sinf(angle);
+}
+///////////////////////////////////////////////////////////////////////////////
+void Obstacle::SetVelocity(float vx, float vy, float w)
+{
+	fVX = vx;
+	fVY = vy;
+	fW = w;
+}
+///////////////////////////////////////////////////////////////////////////////
+void Obstacle::Step(float dt)
+{
+	SetTransform(fX + fVX * dt, fY + fVY * dt, fAngle + fW * dt);
+}
+///////////////////////////////////////////////////////////////////////////////
+// World bounds of the region where the field can be below its max distance: 
+// the primitives' bounds grown by the max distance, limited to the field's 
+// square, and rotated by the current transform.
+void Obstacle::GetBounds(float * minx, float * miny, float * maxx, float * maxy) const
+{
+	const SdfScene & scene = field.GetScene();
+	float size = fHalf * 2.f;
+	float reach = scene.GetMaxDistance();
+	float b[4] = { size, size, 0.f, 0.f };
+
+	for (int i=0; i<scene.GetPrimitiveCount(); i++)
+	{
+		if (!scene.IsLocal(i))
+		{
+			b[0] = b[1] = 0.f;
+			b[2] = b[3] = size;
+			break;
+		}
+
+		float pb[4];
+		scene.GetBounds(i, &pb[0], &pb[1], &pb[2], &pb[3]);
+		b[0] = std::min(b[0], pb[0] - reach);
+		b[1] = std::min(b[1], pb[1] - reach);
+		b[2] = std::max(b[2], pb[2] + reach);
+		b[3] = std::max(b[3], pb[3] + reach);
+	}
+
+	b[0] = std::max(b[0], 0.f);
+	b[1] = std::max(b[1], 0.f);
+	b[2] = std::max(std::min(b[2], size), b[0]);
+	b[3] = std::max(std::min(b[3], size), b[1]);
+
+	// Rotate the local box's center and extents into the world
+	float cx = ((b[0] + b[2]) * 0.5f) - fHalf;
+	float cy = ((b[1] + b[3]) * 0.5f) - fHalf;
+	float hx = (b[2] - b[0]) * 0.5f;
+	float hy = (b[3] - b[1]) * 0.5f;
+
+	float wx = fX + (fCos * cx) - (fSin * cy);
+	float wy = fY + (fSin * cx) + (fCos * cy);
+	float ex = (fabsf(fCos) * hx) + (fabsf(fSin) * hy);
+	float ey = (fabsf(fSin) * hx) + (fabsf(fCos) * hy);
+
+	*minx = wx - ex;
+	*miny = wy - ey;
+	*maxx = wx + ex;
+	*maxy = wy + ey;
+}
+///////////////////////////////////////////////////////////////////////////////
+void Obstacle::ToLocal(float x, float y, float * outx, float * outy) const
+{
+	float dx = x - fX;
+	float dy = y - fY;
+	*outx = fHalf + (fCos * dx) + (fSin * dy);
+	*outy = fHalf - (fSin * dx) + (fCos * dy);
+}
+///////////////////////////////////////////////////////////////////////////////
+float Obstacle::SampleDistance(float x, float y) const
+{
+	float lx, ly;
+	ToLocal(x, y, &lx, &ly);
+
+	float size = fHalf * 2.f;
+	if (lx < 0.f || ly < 0.f || lx > size || ly > size)
+		return FLT_MAX;
+
+	return field.SampleDistance(lx, ly);
+}
+///////////////////////////////////////////////////////////////////////////////
+float Obstacle::SampleNormal(float x, float y, float * outx, float * outy) const
+{
+	float lx, ly, nx, ny;
+	ToLocal(x, y, &lx, &ly);
+	float len = field.SampleNormal(lx, ly, &nx, &ny);
+
+	*outx = (fCos * nx) - (fSin * ny);
+	*outy = (fSin * nx) + (fCos * ny);
+	return len;
+}
+///////////////////////////////////////////////////////////////////////////////
+void Obstacle::SampleVelocity(float x, float y, float * outx, float * outy) const
+{
+	*outx = fVX - fW * (y - fY);
+	*outy = fVY + fW * (x - fX);
+}
+///////////////////////////////////////////////////////////////////////////////
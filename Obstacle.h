@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HH_SDFC_OBSTACLE_HH
+#define HH_SDFC_OBSTACLE_HH
+
+#include "DistanceField.h"
+
+// A rigid body carrying its own small distance field.  The field's scene is 
+// built in local coordinates with the body's origin at the center of the 
+// field, and is queried through the body's translation and rotation, so the 
+// body can move without its field ever being rebaked.
+class Obstacle
+{
+public:
+	Obstacle();
+	~Obstacle();
+
+	void	Create(int nresolution, float meters);
+	void	SetTransform(float x, float y, float angle);
+	void	SetVelocity(float vx, float vy, float w);
+	void	Step(float dt);
+
+	DistanceField &	GetField() { return field; }
+	float			GetCenter() const { return fHalf; }
+	void			GetBounds(float * minx, float * miny, float * maxx, float * maxy) const;
+
+	float	SampleDistance(float x, float y) const;
+	float	SampleNormal(float x, float y, float * outx, float * outy) const;
+	void	SampleVelocity(float x, float y, float * outx, float * outy) const;
+
+private:
+	Obstacle(const Obstacle &);
+	Obstacle & operator = (const Obstacle &);
+
+	void	ToLocal(float x, float y, float * outx, float * outy) const;
+
+	DistanceField	field;
+	float			fHalf;
+	float			fX;
+	float			fY;
+	float			fAngle;
+	float			fCos;
+	float			fSin;
+	float			fVX;
+	float			fVY;
+	float			fW;
+};
+
+#endif // HH_SDFC_OBSTACLE_HH
@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Parallel.h"
+#include <pthread.h>
+#include <stdint.h>
+
+struct ParallelJob
+{
+	ParallelFunc	fn;
+	void *			context;
+	int				count;
+	volatile int	next;
+};
+
+// The worker pool is started on the first ParallelFor and lives for the rest 
+// of the process.  Each job bumps nGeneration to wake the workers, and the 
+// caller waits until every worker has finished with it.
+static pthread_once_t	PoolOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t	PoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	PoolWake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	PoolDone = PTHREAD_COND_INITIALIZER;
+static ParallelJob *	pPoolJob = NULL;
+static unsigned			nGeneration = 0;
+static int				nWorkers = 0;
+static int				nBusy = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+static void RunJob(ParallelJob * job, int thread)
+{
+	for (;;)
+	{
+		int index = __sync_fetch_and_add(&job->next, 1);
+		if (index >= job->count)
+			break;
+
+		job->fn(job->context, index, thread);
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+static void * WorkerMain(void * data)
+{
+	int thread = (int)(intptr_t) data;
+	unsigned seen = 0;
+
+	pthread_mutex_lock(&PoolMutex);
+	for (;;)
+	{
+		while (nGeneration == seen)
+			pthread_cond_wait(&PoolWake, &PoolMutex);
+
+		seen = nGeneration;
+		ParallelJob * job = pPoolJob;
+		pthread_mutex_unlock(&PoolMutex);
+
+		RunJob(job, thread);
+
+		pthread_mutex_lock(&PoolMutex);
+		if (--nBusy == 0)
+			pthread_cond_signal(&PoolDone);
+	}
+	return NULL;
+}
+///////////////////////////////////////////////////////////////////////////////
+static void StartPool()
+{
+	for (int i=1; i<PARALLEL_THREADS; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, &WorkerMain, (void *)(intptr_t) i) != 0)
+			break;
+
+		pthread_detach(thread);
+		nWorkers++;
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+void ParallelFor(int count, ParallelFunc fn, void * context)
+{
+	ParallelJob job;
+	job.fn = fn;
+	job.context = context;
+	job.count = count;
+	job.next = 0;
+
+	pthread_once(&PoolOnce, &StartPool);
+
+	if (count <= 1 || nWorkers == 0)
+	{
+		RunJob(&job, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&PoolMutex);
+	pPoolJob = &job;
+	nBusy = nWorkers;
+	nGeneration++;
+	pthread_cond_broadcast(&PoolWake);
+	pthread_mutex_unlock(&PoolMutex);
+
+	RunJob(&job, 0);
+
+	pthread_mutex_lock(&PoolMutex);
+	while (nBusy > 0)
+		pthread_cond_wait(&PoolDone, &PoolMutex);
+	pthread_mutex_unlock(&PoolMutex);
+}
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,36 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HH_SDFC_PARALLEL_HH
+#define HH_SDFC_PARALLEL_HH
+
+#define PARALLEL_THREADS 4
+
+typedef void (*ParallelFunc)(void * context, int index, int thread);
+
+// Calls fn(context, index, thread) once for every index in [0, count).  The 
+// calling thread works alongside a pool of PARALLEL_THREADS - 1 persistent 
+// helper threads, and thread identifies which one ran the call.  Returns once 
+// every call is done.  Only one thread may be inside ParallelFor at a time.
+void ParallelFor(int count, ParallelFunc fn, void * context);
+
+#endif // HH_SDFC_PARALLEL_HH
@@ -0,0 +1,520 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SdfScene.h"
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+
+// Most local primitives a point query collects on the stack before falling 
+// back to gathering them into a vector
+#define POINT_QUERY_MAX 64
+
+///////////////////////////////////////////////////////////////////////////////
+static float Clamp(float v, float lo, float hi)
+{
+	return (v < lo) ? lo : ((v > hi) ? hi : v);
+}
+///////////////////////////////////////////////////////////////////////////////
+// Distance between a rectangle and a bounding box, zero if they overlap.
+static float BoundsDistance(const float * bounds, float minx, float miny, float maxx, float maxy)
+{
+	float gx = std::max(0.f, std::max(bounds[0] - maxx, minx - bounds[2]));
+	float gy = std::max(0.f, std::max(bounds[1] - maxy, miny - bounds[3]));
+	return sqrtf(gx*gx + gy*gy);
+}
+///////////////////////////////////////////////////////////////////////////////
+struct SdfScene::CentroidLess
+{
+	const std::vector<Primitive> *	primitives;
+	int								axis;
+
+	bool operator () (int a, int b) const
+	{
+		const float * ba = (*primitives)[a].bounds;
+		const float * bb = (*primitives)[b].bounds;
+		return (ba[axis] + ba[axis + 2]) < (bb[axis] + bb[axis + 2]);
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// -------------------------------- SdfScene ----------------------------------
+//
+///////////////////////////////////////////////////////////////////////////////
+SdfScene::SdfScene()
+:	bDirty(false),
+	fMaxDistance(FLT_MAX)
+{}
+///////////////////////////////////////////////////////////////////////////////
+SdfScene::~SdfScene()
+{}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::Clear()
+{
+	aPrimitives.clear();
+	aPoints.clear();
+	aLocal.clear();
+	aGlobal.clear();
+	aNodes.clear();
+	bDirty = false;
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::SetMaxDistance(float d)
+{
+	fMaxDistance = d;
+}
+///////////////////////////////////////////////////////////////////////////////
+int SdfScene::AddCircle(float x, float y, float r, SdfOp op, bool inverted)
+{
+	Primitive p;
+	p.type = PRIM_CIRCLE;
+	p.op = op;
+	p.inverted = inverted;
+	p.params[0] = x;
+	p.params[1] = y;
+	p.params[2] = r;
+	return AddPrimitive(p);
+}
+///////////////////////////////////////////////////////////////////////////////
+int SdfScene::AddBox(float x, float y, float hw, float hh, float angle, SdfOp op, bool inverted)
+{
+	Primitive p;
+	p.type = PRIM_BOX;
+	p.op = op;
+	p.inverted = inverted;
+	p.params[0] = x;
+	p.params[1] = y;
+	p.params[2] = hw;
+	p.params[3] = hh;
+	p.params[4] = cosf(angle);
+	p.params[5] = sinf(angle);
+	return AddPrimitive(p);
+}
+///////////////////////////////////////////////////////////////////////////////
+int SdfScene::AddCapsule(float x0, float y0, float x1, float y1, float r, SdfOp op, bool inverted)
+{
+	Primitive p;
+	p.type = PRIM_CAPSULE;
+	p.op = op;
+	p.inverted = inverted;
+	p.params[0] = x0;
+	p.params[1] = y0;
+	p.params[2] = x1;
+	p.params[3] = y1;
+	p.params[4] = r;
+	return AddPrimitive(p);
+}
+///////////////////////////////////////////////////////////////////////////////
+int SdfScene::AddPolygon(const float * points, int npoints, SdfOp op, bool inverted)
+{
+	Primitive p;
+	p.type = PRIM_POLYGON;
+	p.op = op;
+	p.inverted = inverted;
+	p.firstPoint = (int) aPoints.size() / 2;
+	p.nPoints = npoints;
+	aPoints.insert(aPoints.end(), points, points + (npoints * 2));
+	return AddPrimitive(p);
+}
+///////////////////////////////////////////////////////////////////////////////
+int SdfScene::AddPrimitive(const Primitive & p)
+{
+	aPrimitives.push_back(p);
+	UpdateBounds(aPrimitives.back());
+	bDirty = true;
+	return (int) aPrimitives.size() - 1;
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::Translate(int primitive, float dx, float dy)
+{
+	Primitive & p = aPrimitives[primitive];
+	switch (p.type)
+	{
+	case PRIM_CIRCLE:
+	case PRIM_BOX:
+		p.params[0] += dx;
+		p.params[1] += dy;
+		break;
+	case PRIM_CAPSULE:
+		p.params[0] += dx;
+		p.params[1] += dy;
+		p.params[2] += dx;
+		p.params[3] += dy;
+		break;
+	case PRIM_POLYGON:
+		for (int i=0; i<p.nPoints; i++)
+		{
+			aPoints[(p.firstPoint + i) * 2] += dx;
+			aPoints[(p.firstPoint + i) * 2 + 1] += dy;
+		}
+		break;
+	}
+
+	UpdateBounds(p);
+	if (!bDirty)
+		RefitBVH();
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::GetBounds(int primitive, float * minx, float * miny, float * maxx, float * maxy) const
+{
+	const Primitive & p = aPrimitives[primitive];
+	*minx = p.bounds[0];
+	*miny = p.bounds[1];
+	*maxx = p.bounds[2];
+	*maxy = p.bounds[3];
+}
+///////////////////////////////////////////////////////////////////////////////
+// A local primitive only changes the result within the max distance of its 
+// bounds.  Inverted and intersecting primitives can change it everywhere.
+bool SdfScene::IsLocal(int primitive) const
+{
+	const Primitive & p = aPrimitives[primitive];
+	return !p.inverted && p.op != SDF_INTERSECT;
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::Prepare() const
+{
+	if (bDirty)
+		BuildBVH();
+}
+///////////////////////////////////////////////////////////////////////////////
+float SdfScene::Distance(float x, float y) const
+{
+	Prepare();
+
+	int local[POINT_QUERY_MAX];
+	int nlocal = Collect(x, y, x, y, local, POINT_QUERY_MAX);
+	float d = fMaxDistance;
+
+	if (nlocal < 0)
+	{
+		std::vector<int> prims;
+		Gather(x, y, x, y, prims);
+		return Distance(x, y, &prims[0], (int) prims.size());
+	}
+
+	// Walk the local and global primitives together, in scene order
+	std::sort(local, local + nlocal);
+	int nglobal = (int) aGlobal.size();
+	int l = 0, g = 0;
+
+	while (l < nlocal || g < nglobal)
+	{
+		int prim;
+		if (g == nglobal || (l < nlocal && local[l] < aGlobal[g]))
+			prim = local[l++];
+		else
+			prim = aGlobal[g++];
+
+		d = Combine(aPrimitives[prim], d, x, y);
+	}
+	return Clamp(d, -fMaxDistance, fMaxDistance);
+}
+///////////////////////////////////////////////////////////////////////////////
+float SdfScene::Distance(float x, float y, const int * primitives, int count) const
+{
+	float d = fMaxDistance;
+	for (int i=0; i<count; i++)
+	{
+		d = Combine(aPrimitives[primitives[i]], d, x, y);
+	}
+	return Clamp(d, -fMaxDistance, fMaxDistance);
+}
+///////////////////////////////////////////////////////////////////////////////
+// Collects, in scene order, every primitive that can affect a point inside 
+// the given rectangle.
+void SdfScene::Gather(float minx, float miny, float maxx, float maxy, std::vector<int> & out) const
+{
+	Prepare();
+
+	out.resize(aLocal.size());
+	int count = out.empty() ? 0 : Collect(minx, miny, maxx, maxy, &out[0], (int) out.size());
+	out.resize(count);
+
+	out.insert(out.end(), aGlobal.begin(), aGlobal.end());
+	std::sort(out.begin(), out.end());
+}
+///////////////////////////////////////////////////////////////////////////////
+// Walks the BVH for the local primitives within the max distance of the 
+// rectangle.  Returns how many were written to out, or -1 if there were more 
+// than max of them.
+int SdfScene::Collect(float minx, float miny, float maxx, float maxy, int * out, int max) const
+{
+	if (aNodes.empty())
+		return 0;
+
+	int count = 0;
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		int n = stack[--top];
+		const Node & node = aNodes[n];
+		if (BoundsDistance(node.bounds, minx, miny, maxx, maxy) >= fMaxDistance)
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i=0; i<node.count; i++)
+			{
+				int prim = aLocal[node.first + i];
+				if (BoundsDistance(aPrimitives[prim].bounds, minx, miny, maxx, maxy) >= fMaxDistance)
+					continue;
+
+				if (count == max)
+					return -1;
+
+				out[count++] = prim;
+			}
+		}
+		else
+		{
+			stack[top++] = node.first;
+			stack[top++] = n + 1;
+		}
+	}
+	return count;
+}
+///////////////////////////////////////////////////////////////////////////////
+float SdfScene::EvaluatePrimitive(const Primitive & p, float x, float y) const
+{
+	const float * k = p.params;
+
+	switch (p.type)
+	{
+	case PRIM_CIRCLE:
+		{
+			float dx = x - k[0];
+			float dy = y - k[1];
+			return sqrtf(dx*dx + dy*dy) - k[2];
+		}
+	case PRIM_BOX:
+		{
+			float dx = x - k[0];
+			float dy = y - k[1];
+			float qx = fabsf(dx * k[4] + dy * k[5]) - k[2];
+			float qy = fabsf(dy * k[4] - dx * k[5]) - k[3];
+			float ox = std::max(qx, 0.f);
+			float oy = std::max(qy, 0.f);
+			return sqrtf(ox*ox + oy*oy) + std::min(std::max(qx, qy), 0.f);
+		}
+	case PRIM_CAPSULE:
+		{
+			float ex = k[2] - k[0];
+			float ey = k[3] - k[1];
+			float wx = x - k[0];
+			float wy = y - k[1];
+			float ee = ex*ex + ey*ey;
+			float t = (ee > 0.f) ? Clamp((wx*ex + wy*ey) / ee, 0.f, 1.f) : 0.f;
+			float dx = wx - ex * t;
+			float dy = wy - ey * t;
+			return sqrtf(dx*dx + dy*dy) - k[4];
+		}
+	case PRIM_POLYGON:
+		{
+			const float * v = &aPoints[p.firstPoint * 2];
+			float best = FLT_MAX;
+			float sign = 1.f;
+
+			for (int i=0, j=p.nPoints-1; i<p.nPoints; j=i, i++)
+			{
+				float ex = v[j*2] - v[i*2];
+				float ey = v[j*2+1] - v[i*2+1];
+				float wx = x - v[i*2];
+				float wy = y - v[i*2+1];
+				float ee = ex*ex + ey*ey;
+				float t = (ee > 0.f) ? Clamp((wx*ex + wy*ey) / ee, 0.f, 1.f) : 0.f;
+				float bx = wx - ex * t;
+				float by = wy - ey * t;
+				best = std::min(best, bx*bx + by*by);
+
+				bool c0 = y >= v[i*2+1];
+				bool c1 = y < v[j*2+1];
+				bool c2 = (ex * wy) > (ey * wx);
+				if ((c0 && c1 && c2) || (!c0 && !c1 && !c2))
+					sign = -sign;
+			}
+			return sign * sqrtf(best);
+		}
+	}
+	return FLT_MAX;
+}
+///////////////////////////////////////////////////////////////////////////////
+float SdfScene::Combine(const Primitive & p, float d, float x, float y) const
+{
+	float v = EvaluatePrimitive(p, x, y);
+	if (p.inverted)
+		v = -v;
+
+	switch (p.op)
+	{
+	case SDF_UNION:		return std::min(d, v);
+	case SDF_SUBTRACT:	return std::max(d, -v);
+	case SDF_INTERSECT:	return std::max(d, v);
+	}
+	return d;
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::UpdateBounds(Primitive & p)
+{
+	const float * k = p.params;
+	float * b = p.bounds;
+
+	switch (p.type)
+	{
+	case PRIM_CIRCLE:
+		b[0] = k[0] - k[2];
+		b[1] = k[1] - k[2];
+		b[2] = k[0] + k[2];
+		b[3] = k[1] + k[2];
+		break;
+	case PRIM_BOX:
+		{
+			float ex = fabsf(k[4]) * k[2] + fabsf(k[5]) * k[3];
+			float ey = fabsf(k[5]) * k[2] + fabsf(k[4]) * k[3];
+			b[0] = k[0] - ex;
+			b[1] = k[1] - ey;
+			b[2] = k[0] + ex;
+			b[3] = k[1] + ey;
+		}
+		break;
+	case PRIM_CAPSULE:
+		b[0] = std::min(k[0], k[2]) - k[4];
+		b[1] = std::min(k[1], k[3]) - k[4];
+		b[2] = std::max(k[0], k[2]) + k[4];
+		b[3] = std::max(k[1], k[3]) + k[4];
+		break;
+	case PRIM_POLYGON:
+		{
+			const float * v = &aPoints[p.firstPoint * 2];
+			b[0] = b[2] = v[0];
+			b[1] = b[3] = v[1];
+			for (int i=1; i<p.nPoints; i++)
+			{
+				b[0] = std::min(b[0], v[i*2]);
+				b[1] = std::min(b[1], v[i*2+1]);
+				b[2] = std::max(b[2], v[i*2]);
+				b[3] = std::max(b[3], v[i*2+1]);
+			}
+		}
+		break;
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::BuildBVH() const
+{
+	aLocal.clear();
+	aGlobal.clear();
+	aNodes.clear();
+	bDirty = false;
+
+	for (int i=0; i<(int) aPrimitives.size(); i++)
+	{
+		if (IsLocal(i))
+			aLocal.push_back(i);
+		else
+			aGlobal.push_back(i);
+	}
+
+	if (aLocal.empty())
+		return;
+
+	BuildNode(0, (int) aLocal.size());
+	RefitBVH();
+}
+///////////////////////////////////////////////////////////////////////////////
+// Nodes are stored depth first, so a node's left child directly follows it 
+// and every child comes after its parent.
+int SdfScene::BuildNode(int first, int count) const
+{
+	int index = (int) aNodes.size();
+	aNodes.push_back(Node());
+
+	float cb[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i=0; i<count; i++)
+	{
+		const float * b = aPrimitives[aLocal[first + i]].bounds;
+		cb[0] = std::min(cb[0], b[0] + b[2]);
+		cb[1] = std::min(cb[1], b[1] + b[3]);
+		cb[2] = std::max(cb[2], b[0] + b[2]);
+		cb[3] = std::max(cb[3], b[1] + b[3]);
+	}
+
+	if (count <= 2)
+	{
+		aNodes[index].first = first;
+		aNodes[index].count = count;
+	}
+	else
+	{
+		CentroidLess less;
+		less.primitives = &aPrimitives;
+		less.axis = ((cb[2] - cb[0]) >= (cb[3] - cb[1])) ? 0 : 1;
+
+		int half = count / 2;
+		std::nth_element(aLocal.begin() + first, aLocal.begin() + first + half,
+			aLocal.begin() + first + count, less);
+
+		BuildNode(first, half);
+		int right = BuildNode(first + half, count - half);
+		aNodes[index].first = right;
+		aNodes[index].count = 0;
+	}
+
+	return index;
+}
+///////////////////////////////////////////////////////////////////////////////
+void SdfScene::RefitBVH() const
+{
+	for (int n=(int) aNodes.size()-1; n>=0; n--)
+	{
+		Node & node = aNodes[n];
+		float * b = node.bounds;
+
+		if (node.count > 0)
+		{
+			b[0] = b[1] = FLT_MAX;
+			b[2] = b[3] = -FLT_MAX;
+			for (int i=0; i<node.count; i++)
+			{
+				const float * pb = aPrimitives[aLocal[node.first + i]].bounds;
+				b[0] = std::min(b[0], pb[0]);
+				b[1] = std::min(b[1], pb[1]);
+				b[2] = std::max(b[2], pb[2]);
+				b[3] = std::max(b[3], pb[3]);
+			}
+		}
+		else
+		{
+			const float * lb = aNodes[n + 1].bounds;
+			const float * rb = aNodes[node.first].bounds;
+			b[0] = std::min(lb[0], rb[0]);
+			b[1] = std::min(lb[1], rb[1]);
+			b[2] = std::max(lb[2], rb[2]);
+			b[3] = std::max(lb[3], rb[3]);
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
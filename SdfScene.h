@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HH_SDFC_SDFSCENE_HH
+#define HH_SDFC_SDFSCENE_HH
+
+#include <vector>
+
+enum SdfOp
+{
+	SDF_UNION,
+	SDF_SUBTRACT,
+	SDF_INTERSECT
+};
+
+// An ordered list of analytic primitives, each combined into the result of 
+// the ones before it with a CSG operation.  Inverted primitives use their 
+// complement, so an inverted circle is solid everywhere outside of it.  
+// Distances are clamped to +/- the max distance, which lets queries skip 
+// primitives that are further away than that.  Queries are safe to make from 
+// several threads at once only after Prepare() has been called.
+class SdfScene
+{
+public:
+	SdfScene();
+	~SdfScene();
+
+	void	Clear();
+	void	SetMaxDistance(float d);
+	float	GetMaxDistance() const { return fMaxDistance; }
+
+	int		AddCircle(float x, float y, float r, SdfOp op = SDF_UNION, bool inverted = false);
+	int		AddBox(float x, float y, float hw, float hh, float angle, SdfOp op = SDF_UNION, bool inverted = false);
+	int		AddCapsule(float x0, float y0, float x1, float y1, float r, SdfOp op = SDF_UNION, bool inverted = false);
+	int		AddPolygon(const float * points, int npoints, SdfOp op = SDF_UNION, bool inverted = false);
+
+	void	Translate(int primitive, float dx, float dy);
+	void	GetBounds(int primitive, float * minx, float * miny, float * maxx, float * maxy) const;
+	bool	IsLocal(int primitive) const;
+	int		GetPrimitiveCount() const { return (int) aPrimitives.size(); }
+	void	Prepare() const;
+
+	float	Distance(float x, float y) const;
+	float	Distance(float x, float y, const int * primitives, int count) const;
+	void	Gather(float minx, float miny, float maxx, float maxy, std::vector<int> & out) const;
+
+private:
+	enum Type
+	{
+		PRIM_CIRCLE,
+		PRIM_BOX,
+		PRIM_CAPSULE,
+		PRIM_POLYGON
+	};
+
+	struct Primitive
+	{
+		Type	type;
+		SdfOp	op;
+		bool	inverted;
+		float	params[6];
+		int		firstPoint;
+		int		nPoints;
+		float	bounds[4];
+	};
+
+	struct Node
+	{
+		float	bounds[4];
+		int		first;		// first primitive (leaf) or right child (interior)
+		int		count;		// number of primitives, 0 for interior nodes
+	};
+
+	struct CentroidLess;
+
+	int		AddPrimitive(const Primitive & p);
+	float	EvaluatePrimitive(const Primitive & p, float x, float y) const;
+	float	Combine(const Primitive & p, float d, float x, float y) const;
+	void	UpdateBounds(Primitive & p);
+	int		Collect(float minx, float miny, float maxx, float maxy, int * out, int max) const;
+	void	BuildBVH() const;
+	int		BuildNode(int first, int count) const;
+	void	RefitBVH() const;
+
+	// The BVH is rebuilt lazily, on the first query after primitives are added
+	std::vector<Primitive>		aPrimitives;
+	std::vector<float>			aPoints;
+	mutable std::vector<int>	aLocal;		// primitives in the BVH, in leaf order
+	mutable std::vector<int>	aGlobal;	// primitives that can affect any point
+	mutable std::vector<Node>	aNodes;
+	mutable bool				bDirty;
+	float						fMaxDistance;
+};
+
+#endif // HH_SDFC_SDFSCENE_HH
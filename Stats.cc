@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Stats.h"
+#include <stddef.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ---------------------------------- Stats -----------------------------------
+//
+///////////////////////////////////////////////////////////////////////////////
+Stats::Stats()
+:	nNext(0),
+	nPending(0),
+	nInterval(30)
+{
+	memset(aRing, 0, sizeof(aRing));
+	memset(&packet, 0, sizeof(packet));
+	memset(aHistogram, 0, sizeof(aHistogram));
+}
+///////////////////////////////////////////////////////////////////////////////
+void Stats::SetPublishInterval(int nframes)
+{
+	nInterval = (nframes < 1) ? 1 : ((nframes > STATS_RING_SIZE) ? STATS_RING_SIZE : nframes);
+}
+///////////////////////////////////////////////////////////////////////////////
+void Stats::Record(const FrameStats & frame)
+{
+	aRing[nNext] = frame;
+	nNext = (nNext + 1) % STATS_RING_SIZE;
+	nPending = (nPending < STATS_RING_SIZE) ? nPending + 1 : STATS_RING_SIZE;
+
+	uint32_t bucket = frame.frameUS / STATS_HISTOGRAM_US;
+	aHistogram[(bucket < STATS_HISTOGRAM_BUCKETS) ? bucket : STATS_HISTOGRAM_BUCKETS - 1]++;
+}
+///////////////////////////////////////////////////////////////////////////////
+// Packs the pending frames, oldest first, and starts a new publish interval.
+const StatsPacket & Stats::Publish()
+{
+	packet.magic = STATS_MAGIC;
+	packet.version = STATS_VERSION;
+	packet.count = nPending;
+	memcpy(packet.histogram, aHistogram, sizeof(aHistogram));
+
+	int first = (nNext + STATS_RING_SIZE - nPending) % STATS_RING_SIZE;
+	for (int i=0; i<nPending; i++)
+	{
+		packet.frames[i] = aRing[(first + i) % STATS_RING_SIZE];
+	}
+
+	nPending = 0;
+	memset(aHistogram, 0, sizeof(aHistogram));
+	return packet;
+}
+///////////////////////////////////////////////////////////////////////////////
+// Size in bytes of the last published packet.
+int Stats::GetPacketSize() const
+{
+	return (int)(offsetof(StatsPacket, frames) + (packet.count * sizeof(FrameStats)));
+}
+///////////////////////////////////////////////////////////////////////////////
+// Publishes to a file or stdout for builds that have no page to post to.
+bool Stats::Write(FILE * file)
+{
+	Publish();
+	size_t size = GetPacketSize();
+	return fwrite(&packet, 1, size, file) == size;
+}
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2012 Chris Lentini
+http://divergentcoder.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in 
+the Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the 
+Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all 
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS 
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR 
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER 
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HH_SDFC_STATS_HH
+#define HH_SDFC_STATS_HH
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_MAGIC 0x53464453		// "SDFS" when read as little endian bytes
+#define STATS_VERSION 1
+#define STATS_RING_SIZE 64
+#define STATS_HISTOGRAM_BUCKETS 16
+#define STATS_HISTOGRAM_US 2000		// width of each frame time bucket
+
+// One frame's counters.  Times are in microseconds.
+struct FrameStats
+{
+	uint32_t	frame;
+	uint32_t	frameUS;
+	uint32_t	updateUS;
+	uint32_t	renderUS;
+	uint32_t	collisions;
+	uint32_t	ccdIterations;
+	uint32_t	activeParticles;
+};
+
+// The published message: a fixed header followed by count FrameStats, all 
+// little endian uint32s.  The histogram covers every frame since the last 
+// publish, with the last bucket holding anything slower.
+struct StatsPacket
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	count;
+	uint32_t	histogram[STATS_HISTOGRAM_BUCKETS];
+	FrameStats	frames[STATS_RING_SIZE];
+};
+
+// Collects FrameStats into a ring and packs the frames recorded since the 
+// last publish into a StatsPacket every publish interval frames.
+class Stats
+{
+public:
+	Stats();
+
+	void	SetPublishInterval(int nframes);
+	void	Record(const FrameStats & frame);
+	bool	IsPublishDue() const { return nPending >= nInterval; }
+
+	const StatsPacket &	Publish();
+	int					GetPacketSize() const;
+	bool				Write(FILE * file);
+
+private:
+	FrameStats	aRing[STATS_RING_SIZE];
+	StatsPacket	packet;
+	uint32_t	aHistogram[STATS_HISTOGRAM_BUCKETS];
+	int			nNext;
+	int			nPending;
+	int			nInterval;
+};
+
+#endif // HH_SDFC_STATS_HH
@@ -33,6 +33,13 @@ inline int64_t GetTimeMS()
 	return (int64_t)(t.tv_sec) * 1000 + (t.tv_usec / 1000);
 }
 ///////////////////////////////////////////////////////////////////////////////
+inline int64_t GetTimeUS() 
+{
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return (int64_t)(t.tv_sec) * 1000000 + t.tv_usec;
+}
+///////////////////////////////////////////////////////////////////////////////
 inline float frand()
 {
 	return rand() / (float)RAND_MAX;
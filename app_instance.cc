@@ -22,8 +22,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "app_instance.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ppapi/cpp/completion_callback.h>
 #include <ppapi/cpp/Var.h>
+#include <ppapi/cpp/var_array_buffer.h>
 #include "Util.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -41,6 +44,9 @@ extern void AddMousePuff(float x, float y);
 extern void ToggleSurface();
 extern void ToggleDistance();
 extern void ToggleFiltering();
+extern void ToggleSplatting();
+extern void ToggleMetaballs();
+extern void GetSimulationStats(int *, int *, int *);
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -53,7 +59,9 @@ AppInstance::AppInstance(PP_Instance instance)
 		pixels(NULL),
 		nWidth(0),
 		nHeight(0),
-		bFlushIsPending(false)
+		bFlushIsPending(false),
+		nFrame(0),
+		nLastPaintUS(0)
 {
 	RequestInputEvents(PP_INPUTEVENT_CLASS_MOUSE);
 	InitSimulation(10000);
@@ -87,6 +95,18 @@ void AppInstance::HandleMessage(const pp::Var & var_message)
 	{
 		ToggleFiltering();
 	}
+	else if (message == "ToggleSplatting")
+	{
+		ToggleSplatting();
+	}
+	else if (message == "ToggleMetaballs")
+	{
+		ToggleMetaballs();
+	}
+	else if (message.compare(0, 14, "StatsInterval ") == 0)
+	{
+		stats.SetPublishInterval(atoi(message.c_str() + 14));
+	}
 }
 ///////////////////////////////////////////////////////////////////////////////
 bool AppInstance::HandleInputEvent(const pp::InputEvent & event)
@@ -129,26 +149,53 @@ void AppInstance::DidChangeView(const pp::Rect & position,
 ///////////////////////////////////////////////////////////////////////////////
 void AppInstance::Paint()
 {
-	char msg[255];
-
-	int64_t start, end;
-	start = GetTimeMS();
+	FrameStats frame;
+	int64_t start, mid, end;
+	start = GetTimeUS();
 
 	UpdateSimulation(1.f / 30.f);
 
-	end = GetTimeMS();
-
-	sprintf(msg, "Update Time: %d ms", (int)(end - start));
-	PostMessage(pp::Var(msg));
-
-	start = GetTimeMS();
+	mid = GetTimeUS();
 
 	RenderSimulation((int32_t *) pixels->data(), nWidth, nHeight);
 	FlushPixelBuffer();
 
-	end = GetTimeMS();
-	sprintf(msg, "Render Time: %d ms", (int)(end - start));
-	PostMessage(pp::Var(msg));
+	end = GetTimeUS();
+
+	int collisions, iterations, active;
+	GetSimulationStats(&collisions, &iterations, &active);
+
+	frame.frame = nFrame++;
+	frame.frameUS = nLastPaintUS ? (uint32_t)(start - nLastPaintUS) : 0;
+	frame.updateUS = (uint32_t)(mid - start);
+	frame.renderUS = (uint32_t)(end - mid);
+	frame.collisions = collisions;
+	frame.ccdIterations = iterations;
+	frame.activeParticles = active;
+	nLastPaintUS = start;
+
+	stats.Record(frame);
+	if (stats.IsPublishDue())
+		PublishStats();
+}
+///////////////////////////////////////////////////////////////////////////////
+// Posts the frames recorded since the last publish as a single ArrayBuffer 
+// laid out as a StatsPacket.  Building with STATS_TO_STDOUT writes the same 
+// packets to stdout instead, for running without a page to read them.
+void AppInstance::PublishStats()
+{
+#ifdef STATS_TO_STDOUT
+	stats.Write(stdout);
+	fflush(stdout);
+#else
+	const StatsPacket & packet = stats.Publish();
+	int size = stats.GetPacketSize();
+
+	pp::VarArrayBuffer buffer(size);
+	memcpy(buffer.Map(), &packet, size);
+	buffer.Unmap();
+	PostMessage(buffer);
+#endif
 }
 ///////////////////////////////////////////////////////////////////////////////
 void AppInstance::FlushPixelBuffer()
@@ -29,6 +29,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <ppapi/cpp/rect.h>
 #include <ppapi/cpp/size.h>
 #include <ppapi/cpp/input_event.h>
+#include "Stats.h"
 
 class AppInstance : public pp::Instance 
 {
@@ -45,6 +46,7 @@ public:
 
 private:
 	void FlushPixelBuffer();
+	void PublishStats();
 	void CreateContext(const pp::Size & size);
 	void DestroyContext();
 
@@ -53,6 +55,10 @@ private:
 	int 				nWidth;
 	int 				nHeight;
 	bool				bFlushIsPending;
+
+	Stats				stats;
+	uint32_t			nFrame;
+	int64_t				nLastPaintUS;
 };
 
 #endif // HH_APP_INSTANCE_HH
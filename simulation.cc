@@ -23,10 +23,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <algorithm>
 #include <vector>
 #include <math.h>
+#include <float.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "Util.h"
 #include "DistanceField.h"
+#include "Obstacle.h"
+#include "Parallel.h"
 
 struct Particle
 {
@@ -41,6 +45,12 @@ void ResolveCollisions(Particle &, float);
 
 #define RES 64
 #define TANK_SIZE 10.f
+#define SORT_INTERVAL 16
+#define SORT_PASSES 2
+#define BROAD_RES 8
+#define SPLAT_SHIFT 2
+#define SPLAT_CHUNKS (PARALLEL_THREADS * 4)
+#define SPLAT_FULL 4.f
 
 // Simulation Parameters
 float	fGravity;
@@ -51,10 +61,55 @@ float	fFriction;
 bool	bRenderSurface;
 bool	bRenderDistance;
 bool	bRenderFiltered;
+bool	bRenderSplats;
+bool	bRenderMetaballs;
+
+// Statistics - accumulated until read by GetSimulationStats
+int		nCollisions;
+int		nCCDIterations;
+int		nActiveParticles;
 
 DistanceField 		SDF;
 Particle *			aParticles;
 int 				nParticles;
+
+// Spatial Ordering - particles are periodically radix sorted by the Morton 
+// key of their position so that neighbouring iterations touch neighbouring 
+// parts of the distance field and the framebuffer.  aParticleIds maps a slot 
+// back to the particle's id and aParticleSlots maps an id to its current slot.
+Particle *			aParticlesTemp;
+uint32_t *			aSortKeys;
+uint32_t *			aSortKeysTemp;
+int *				aParticleIds;
+int *				aParticleIdsTemp;
+int *				aParticleSlots;
+int					nSortPass;
+int					nStepsSinceSort;
+
+// Moving Obstacles - each broad phase cell lists the obstacles whose bounds 
+// overlap it, so a particle only tests the obstacles near it.
+std::vector<Obstacle *>		aObstacles;
+std::vector<int>			aBroadPhase[BROAD_RES * BROAD_RES];
+
+// Splat Rendering - each thread accumulates particles into its own density 
+// histogram at 1 / (1 << SPLAT_SHIFT) of the framebuffer resolution.  The 
+// histograms are then merged row by row, and the result is upscaled and 
+// mapped through aSplatRamp to the coverage of the particle colour.  Density 
+// is in 1/256ths of a particle.
+uint32_t *			aSplatHistograms[PARALLEL_THREADS];
+uint32_t *			aSplatDensity;
+int					nSplatWidth;
+int					nSplatHeight;
+int					aSplatRamp[256];
+
+struct SplatTarget
+{
+	int32_t *	pixels;
+	int			xres;
+	int			yres;
+};
+
+void BuildSplatRamp();
 ///////////////////////////////////////////////////////////////////////////////
 void InitSimulation(int count)
 {
@@ -65,9 +120,29 @@ void InitSimulation(int count)
 	bRenderDistance = false;
 	bRenderSurface = true;
 	bRenderFiltered = true;
+	bRenderSplats = false;
+	bRenderMetaballs = false;
+
+	nCollisions = 0;
+	nCCDIterations = 0;
+	nActiveParticles = count;
+
+	memset(aSplatHistograms, 0, sizeof(aSplatHistograms));
+	aSplatDensity = NULL;
+	nSplatWidth = 0;
+	nSplatHeight = 0;
+	BuildSplatRamp();
 
 	aParticles = new Particle[count];
+	aParticlesTemp = new Particle[count];
+	aSortKeys = new uint32_t[count];
+	aSortKeysTemp = new uint32_t[count];
+	aParticleIds = new int[count];
+	aParticleIdsTemp = new int[count];
+	aParticleSlots = new int[count];
 	nParticles = count;
+	nSortPass = 0;
+	nStepsSinceSort = SORT_INTERVAL;
 
 	for (int i=0; i<count; i++)
 	{
@@ -76,18 +151,196 @@ void InitSimulation(int count)
 		p.y = (TANK_SIZE - 3.f) + frand() * 0.5f;
 		p.vx = 3.f - 6.f * frand();
 		p.vy = 8.f;
+
+		aParticleIds[i] = i;
+		aParticleSlots[i] = i;
 	}
 
 	SDF.Create(32, TANK_SIZE);
+	SDF.GetScene().SetMaxDistance(2.f);
 	SDF.SubCircle(5.f, 5.f, 4.5f);
 	SDF.AddCircle(5.f, 5.f, 1.25f);
 	SDF.AddCircle(0.f, 5.f, 2.f);
 	SDF.AddCircle(10.f, 5.f, 2.f);
+	SDF.Refine(8, 0.5f);
+
+	// A two armed paddle turning around the center post
+	Obstacle * paddle = new Obstacle();
+	paddle->Create(32, 8.f);
+	float c = paddle->GetCenter();
+	SdfScene & scene = paddle->GetField().GetScene();
+	scene.SetMaxDistance(0.25f);
+	scene.AddBox(c - 2.55f, c, 1.25f, 0.1f, 0.f);
+	scene.AddBox(c + 2.55f, c, 1.25f, 0.1f, 0.f);
+	paddle->GetField().Refine(8, 0.25f);
+	paddle->SetTransform(5.f, 5.f, 0.f);
+	paddle->SetVelocity(0.f, 0.f, 0.8f);
+	aObstacles.push_back(paddle);
 }
 ///////////////////////////////////////////////////////////////////////////////
 void ShutdownSimulation()
 {
 	delete [] aParticles;
+	delete [] aParticlesTemp;
+	delete [] aSortKeys;
+	delete [] aSortKeysTemp;
+	delete [] aParticleIds;
+	delete [] aParticleIdsTemp;
+	delete [] aParticleSlots;
+
+	for (size_t i=0; i<aObstacles.size(); i++)
+	{
+		delete aObstacles[i];
+	}
+	aObstacles.clear();
+
+	for (int i=0; i<PARALLEL_THREADS; i++)
+	{
+		delete [] aSplatHistograms[i];
+	}
+	delete [] aSplatDensity;
+}
+///////////////////////////////////////////////////////////////////////////////
+Particle & GetParticle(int id)
+{
+	return aParticles[aParticleSlots[id]];
+}
+///////////////////////////////////////////////////////////////////////////////
+uint32_t SpreadBits(uint32_t v)
+{
+	v &= 0xff;
+	v = (v | (v << 4)) & 0x0f0f;
+	v = (v | (v << 2)) & 0x3333;
+	v = (v | (v << 1)) & 0x5555;
+	return v;
+}
+///////////////////////////////////////////////////////////////////////////////
+uint32_t MortonKey(float x, float y)
+{
+	int ix = (int)((x / TANK_SIZE) * 256.f);
+	int iy = (int)((y / TANK_SIZE) * 256.f);
+	ix = (ix < 0) ? 0 : ((ix > 255) ? 255 : ix);
+	iy = (iy < 0) ? 0 : ((iy > 255) ? 255 : iy);
+	return SpreadBits(ix) | (SpreadBits(iy) << 1);
+}
+///////////////////////////////////////////////////////////////////////////////
+// Performs a single 8 bit pass of an LSD radix sort on the Morton keys.  The 
+// keys are computed on the first pass and carried along with the particles, 
+// so the passes of one sort can be spread over consecutive steps.
+void SortParticles()
+{
+	if (nSortPass == 0)
+	{
+		for (int i=0; i<nParticles; i++)
+		{
+			aSortKeys[i] = MortonKey(aParticles[i].x, aParticles[i].y);
+		}
+	}
+
+	int shift = nSortPass * 8;
+	int offsets[256];
+	memset(offsets, 0, sizeof(offsets));
+
+	for (int i=0; i<nParticles; i++)
+	{
+		offsets[(aSortKeys[i] >> shift) & 0xff]++;
+	}
+
+	for (int i=0, total=0; i<256; i++)
+	{
+		int count = offsets[i];
+		offsets[i] = total;
+		total += count;
+	}
+
+	for (int i=0; i<nParticles; i++)
+	{
+		int j = offsets[(aSortKeys[i] >> shift) & 0xff]++;
+		aParticlesTemp[j] = aParticles[i];
+		aSortKeysTemp[j] = aSortKeys[i];
+		aParticleIdsTemp[j] = aParticleIds[i];
+		aParticleSlots[aParticleIds[i]] = j;
+	}
+
+	std::swap(aParticles, aParticlesTemp);
+	std::swap(aSortKeys, aSortKeysTemp);
+	std::swap(aParticleIds, aParticleIdsTemp);
+
+	if (++nSortPass == SORT_PASSES)
+		nSortPass = 0;
+}
+///////////////////////////////////////////////////////////////////////////////
+void UpdateBroadPhase()
+{
+	for (int i=0; i<BROAD_RES * BROAD_RES; i++)
+	{
+		aBroadPhase[i].clear();
+	}
+
+	float scale = BROAD_RES / TANK_SIZE;
+	for (size_t i=0; i<aObstacles.size(); i++)
+	{
+		float minx, miny, maxx, maxy;
+		aObstacles[i]->GetBounds(&minx, &miny, &maxx, &maxy);
+
+		int x0 = std::max((int)(minx * scale), 0);
+		int y0 = std::max((int)(miny * scale), 0);
+		int x1 = std::min((int)(maxx * scale), BROAD_RES - 1);
+		int y1 = std::min((int)(maxy * scale), BROAD_RES - 1);
+
+		for (int y=y0; y<=y1; y++)
+		{
+			for (int x=x0; x<=x1; x++)
+			{
+				aBroadPhase[(y * BROAD_RES) + x].push_back((int) i);
+			}
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+// Distance to the nearest moving obstacle.  hit is set to its index, or -1 
+// if no obstacle is near.
+float SampleObstacles(float x, float y, int * hit)
+{
+	float d = FLT_MAX;
+	*hit = -1;
+
+	int bx = std::min(std::max((int)(x * (BROAD_RES / TANK_SIZE)), 0), BROAD_RES - 1);
+	int by = std::min(std::max((int)(y * (BROAD_RES / TANK_SIZE)), 0), BROAD_RES - 1);
+	const std::vector<int> & cell = aBroadPhase[(by * BROAD_RES) + bx];
+
+	for (size_t i=0; i<cell.size(); i++)
+	{
+		float od = aObstacles[cell[i]]->SampleDistance(x, y);
+		if (od < d)
+		{
+			d = od;
+			*hit = cell[i];
+		}
+	}
+	return d;
+}
+///////////////////////////////////////////////////////////////////////////////
+// Distance to the nearest solid, static or moving.  hit is set to the index 
+// of the obstacle that is nearest, or -1 for the static field.
+float SampleScene(float x, float y, int * hit)
+{
+	float d = SampleObstacles(x, y, hit);
+	float sd = SDF.SampleDistance(x, y);
+	if (sd <= d)
+	{
+		*hit = -1;
+		return sd;
+	}
+	return d;
+}
+///////////////////////////////////////////////////////////////////////////////
+void SampleSceneNormal(float x, float y, int hit, float * outx, float * outy)
+{
+	if (hit < 0)
+		SDF.SampleNormal(x, y, outx, outy);
+	else
+		aObstacles[hit]->SampleNormal(x, y, outx, outy);
 }
 ///////////////////////////////////////////////////////////////////////////////
 void DrawCircle(int32_t * pixels, int xres, int yres, int x, int y, int r, int rgb = 0xff0000ff)
@@ -109,6 +362,159 @@ void DrawCircle(int32_t * pixels, int xres, int yres, int x, int y, int r, int r
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////
+// Maps density, in 1/8ths of a particle, to coverage out of 256.  Metaballs 
+// use a steep ramp around a threshold to give the fluid a solid surface.
+void BuildSplatRamp()
+{
+	for (int i=0; i<256; i++)
+	{
+		float count = i / 8.f;
+		float a;
+
+		if (bRenderMetaballs)
+		{
+			float t = (count - 1.25f) / 0.5f;
+			t = (t < 0.f) ? 0.f : ((t > 1.f) ? 1.f : t);
+			a = t * t * (3.f - 2.f * t);
+		}
+		else
+		{
+			a = 1.f - expf(-count / SPLAT_FULL);
+		}
+
+		aSplatRamp[i] = (int)(a * 256.f);
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+void ResizeSplatBuffers(int width, int height)
+{
+	if (width == nSplatWidth && height == nSplatHeight)
+		return;
+
+	nSplatWidth = width;
+	nSplatHeight = height;
+
+	for (int i=0; i<PARALLEL_THREADS; i++)
+	{
+		delete [] aSplatHistograms[i];
+		aSplatHistograms[i] = new uint32_t[width * height];
+		memset(aSplatHistograms[i], 0, sizeof(uint32_t) * width * height);
+	}
+
+	delete [] aSplatDensity;
+	aSplatDensity = new uint32_t[width * height];
+}
+///////////////////////////////////////////////////////////////////////////////
+// Bilinearly splats one chunk of the particles into the calling thread's 
+// histogram.
+void SplatParticles(void * context, int index, int thread)
+{
+	const SplatTarget * target = (const SplatTarget *) context;
+	uint32_t * histogram = aSplatHistograms[thread];
+	int w = nSplatWidth;
+	int h = nSplatHeight;
+	int maxx = ((w - 1) << 8) - 1;
+	int maxy = ((h - 1) << 8) - 1;
+	float scalex = ((target->xres << 8) >> SPLAT_SHIFT) / TANK_SIZE;
+	float scaley = ((target->yres << 8) >> SPLAT_SHIFT) / TANK_SIZE;
+
+	int first = (int)(((int64_t) nParticles * index) / SPLAT_CHUNKS);
+	int last = (int)(((int64_t) nParticles * (index + 1)) / SPLAT_CHUNKS);
+
+	for (int i=first; i<last; i++)
+	{
+		const Particle & p = aParticles[i];
+		int sx = (int)(p.x * scalex) - 128;
+		int sy = (int)((TANK_SIZE - p.y) * scaley) - 128;
+		sx = (sx < 0) ? 0 : ((sx > maxx) ? maxx : sx);
+		sy = (sy < 0) ? 0 : ((sy > maxy) ? maxy : sy);
+
+		int fx = sx & 0xff;
+		int fy = sy & 0xff;
+		uint32_t * cell = histogram + ((sy >> 8) * w) + (sx >> 8);
+
+		cell[0] += ((256 - fx) * (256 - fy)) >> 8;
+		cell[1] += (fx * (256 - fy)) >> 8;
+		cell[w] += ((256 - fx) * fy) >> 8;
+		cell[w + 1] += (fx * fy) >> 8;
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+// Sums one row of every thread's histogram into the density buffer, clearing 
+// the histograms for the next frame.
+void MergeSplatRow(void * context, int row, int thread)
+{
+	int w = nSplatWidth;
+	uint32_t * out = aSplatDensity + (row * w);
+	memset(out, 0, sizeof(uint32_t) * w);
+
+	for (int t=0; t<PARALLEL_THREADS; t++)
+	{
+		uint32_t * in = aSplatHistograms[t] + (row * w);
+		for (int x=0; x<w; x++)
+		{
+			out[x] += in[x];
+		}
+		memset(in, 0, sizeof(uint32_t) * w);
+	}
+
+	for (int x=0; x<w; x++)
+	{
+		out[x] = (out[x] > (255 << 5)) ? (255 << 5) : out[x];
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+// Upscales the density buffer into one framebuffer row and blends the 
+// particle colour over whatever is already there.
+void ResolveSplatRow(void * context, int y, int thread)
+{
+	const SplatTarget * target = (const SplatTarget *) context;
+	int32_t * row = target->pixels + (y * target->xres);
+	int w = nSplatWidth;
+	int maxx = ((w - 1) << 8) - 1;
+	int maxy = ((nSplatHeight - 1) << 8) - 1;
+
+	int sy = ((((y << 8) + 128) >> SPLAT_SHIFT) - 128);
+	sy = (sy < 0) ? 0 : ((sy > maxy) ? maxy : sy);
+	int fy = sy & 0xff;
+	const uint32_t * d0 = aSplatDensity + ((sy >> 8) * w);
+	const uint32_t * d1 = d0 + w;
+
+	for (int x=0; x<target->xres; x++)
+	{
+		int sx = ((((x << 8) + 128) >> SPLAT_SHIFT) - 128);
+		sx = (sx < 0) ? 0 : ((sx > maxx) ? maxx : sx);
+		int fx = sx & 0xff;
+		int ix = sx >> 8;
+
+		uint32_t top = (d0[ix] * (256 - fx) + d0[ix + 1] * fx) >> 8;
+		uint32_t bottom = (d1[ix] * (256 - fx) + d1[ix + 1] * fx) >> 8;
+		uint32_t d = (top * (256 - fy) + bottom * fy) >> 8;
+
+		int a = aSplatRamp[d >> 5];
+		if (a == 0)
+			continue;
+
+		uint32_t bg = (uint32_t) row[x];
+		uint32_t fg = 0xffff7f00;
+		uint32_t rb = ((bg & 0x00ff00ff) * (256 - a) + (fg & 0x00ff00ff) * a) >> 8;
+		uint32_t ag = (((bg >> 8) & 0x00ff00ff) * (256 - a) + ((fg >> 8) & 0x00ff00ff) * a);
+		row[x] = (int32_t)((rb & 0x00ff00ff) | (ag & 0xff00ff00));
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+void RenderSplats(int32_t * pixels, int xres, int yres)
+{
+	int w = std::max((xres + (1 << SPLAT_SHIFT) - 1) >> SPLAT_SHIFT, 2);
+	int h = std::max((yres + (1 << SPLAT_SHIFT) - 1) >> SPLAT_SHIFT, 2);
+	ResizeSplatBuffers(w, h);
+
+	SplatTarget target = { pixels, xres, yres };
+	ParallelFor(SPLAT_CHUNKS, &SplatParticles, &target);
+	ParallelFor(h, &MergeSplatRow, NULL);
+	ParallelFor(yres, &ResolveSplatRow, &target);
+}
+///////////////////////////////////////////////////////////////////////////////
 void RenderSimulation(int32_t * pixels, int xres, int yres)
 {
 	memset(pixels, 0, sizeof(int32_t) * xres * yres);
@@ -128,15 +534,16 @@ void RenderSimulation(int32_t * pixels, int xres, int yres)
 
 				if (!bRenderFiltered)
 				{
-					int mx = ((x * 32) / xres);
-					int my = ((y * 32) / yres);
-					d = SDF.SampleDistance(mx,my);	
+					d = SDF.SampleNearest(fx, fy);	
 				}
 				else
 				{
 					d = SDF.SampleDistance(fx, fy);	
 				}
 
+				int hit;
+				d = std::min(d, SampleObstacles(fx, fy, &hit));
+
 				int id = y*xres+x;
 				if (d < 0.015f && d > -0.015f && bRenderSurface)
 				{
@@ -152,6 +559,12 @@ void RenderSimulation(int32_t * pixels, int xres, int yres)
 		}
 	}
 
+	if (bRenderSplats)
+	{
+		RenderSplats(pixels, xres, yres);
+		return;
+	}
+
 	for (int i=0; i<nParticles; i++)
 	{
 		Particle & p = aParticles[i];
@@ -163,10 +576,26 @@ void RenderSimulation(int32_t * pixels, int xres, int yres)
 ///////////////////////////////////////////////////////////////////////////////
 void UpdateSimulation(float dt)
 {
+	if (nSortPass > 0 || ++nStepsSinceSort >= SORT_INTERVAL)
+	{
+		nStepsSinceSort = 0;
+		SortParticles();
+	}
+
+	for (size_t i=0; i<aObstacles.size(); i++)
+	{
+		aObstacles[i]->Step(dt);
+	}
+	UpdateBroadPhase();
+
+	nActiveParticles = 0;
 	for (int i=0; i<nParticles; i++)
 	{
 		Particle & p = aParticles[i];
 
+		if ((p.vx * p.vx) + (p.vy * p.vy) > 0.01f)
+			nActiveParticles++;
+
 		float vy = p.vy;
 		p.vy += dt * fGravity;
 		p.y += (vy + p.vy) * 0.5f * dt;
@@ -176,15 +605,20 @@ void UpdateSimulation(float dt)
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////
-float FindCollisionDT(Particle & pt, float dt0, float dt1, int iter = 0)
+// Bisects for the time the particle, moving at (vx, vy) relative to whatever 
+// it hit, crossed the surface.
+float FindCollisionDT(Particle & pt, float vx, float vy, float dt0, float dt1)
 {
 	float dt = (dt0 + dt1) * 0.5f;
 
 	for (int i=0; i<4; i++)
 	{
-		float x = pt.x - pt.vx * dt;
-		float y = pt.y - pt.vy * dt;
-		float d = SDF.SampleDistance(x, y);
+		nCCDIterations++;
+
+		float x = pt.x - vx * dt;
+		float y = pt.y - vy * dt;
+		int hit;
+		float d = SampleScene(x, y, &hit);
 
 		if (d < -1e-4)
 			dt0 = dt;
@@ -201,28 +635,38 @@ float FindCollisionDT(Particle & pt, float dt0, float dt1, int iter = 0)
 ///////////////////////////////////////////////////////////////////////////////
 void ResolveCollisions(Particle & p, float dt)
 {
-	float d0 = SDF.SampleDistance(p.x, p.y);
+	int hit;
+	float d0 = SampleScene(p.x, p.y, &hit);
 	if (d0 < 0.f)
 	{
-		float dtc = FindCollisionDT(p, 0.f, dt);
+		nCollisions++;
+
+		// Work in the frame of the surface that was hit
+		float ovx = 0.f, ovy = 0.f;
+		if (hit >= 0)
+			aObstacles[hit]->SampleVelocity(p.x, p.y, &ovx, &ovy);
 
-		p.x -= p.vx * dtc;
-		p.y -= p.vy * dtc;
+		float rvx = p.vx - ovx;
+		float rvy = p.vy - ovy;
+		float dtc = FindCollisionDT(p, rvx, rvy, 0.f, dt);
 
-		float nx, ny, l;
-		d0 = SDF.SampleDistance(p.x, p.y);
-		SDF.SampleNormal(p.x, p.y, &nx, &ny);
+		p.x -= rvx * dtc;
+		p.y -= rvy * dtc;
+
+		float nx, ny;
+		d0 = SampleScene(p.x, p.y, &hit);
+		SampleSceneNormal(p.x, p.y, hit, &nx, &ny);
 
 		p.x -= nx * d0;
 		p.y -= ny * d0;
 
-		SDF.SampleNormal(p.x, p.y, &nx, &ny);
+		SampleSceneNormal(p.x, p.y, hit, &nx, &ny);
 	
 		float tx = ny;
 		float ty = -nx;
 
-		float vdn = nx * p.vx + ny * p.vy;
-		float vdt = tx * p.vx + ty * p.vy;
+		float vdn = nx * rvx + ny * rvy;
+		float vdt = tx * rvx + ty * rvy;
 
 		float i = -fFriction * vdt;
 		float j = -(1.f + fRestitution) * vdn;
@@ -248,6 +692,18 @@ void AddMousePuff(float x, float y)
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////
+// Reports the collisions and CCD iterations since the last call, and the 
+// number of particles that were moving during the last step.
+void GetSimulationStats(int * collisions, int * iterations, int * active)
+{
+	*collisions = nCollisions;
+	*iterations = nCCDIterations;
+	*active = nActiveParticles;
+
+	nCollisions = 0;
+	nCCDIterations = 0;
+}
+///////////////////////////////////////////////////////////////////////////////
 void ToggleSurface()
 {
 	bRenderSurface = !bRenderSurface;
@@ -263,3 +719,14 @@ void ToggleFiltering()
 	bRenderFiltered = !bRenderFiltered;	
 }
 ///////////////////////////////////////////////////////////////////////////////
+void ToggleSplatting()
+{
+	bRenderSplats = !bRenderSplats;
+}
+///////////////////////////////////////////////////////////////////////////////
+void ToggleMetaballs()
+{
+	bRenderMetaballs = !bRenderMetaballs;
+	BuildSplatRamp();
+}
+///////////////////////////////////////////////////////////////////////////////